@@ -0,0 +1,351 @@
+#include "clipRecorder.h"
+#include "motionAnalysis.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+#ifdef HAVE_LIBAV
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+#include <cstdint>
+#include <deque>
+#include <vector>
+#endif
+
+namespace fs = std::filesystem;
+
+static std::string clipFilename(const ClipOptions& options, const std::string& videoPath,
+                                int index, double eventSeconds) {
+    std::string extension = fs::path(videoPath).extension().string();
+    if (extension.empty()) extension = ".mp4";
+
+    int total = static_cast<int>(eventSeconds);
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "clip_%04d_%02dh%02dm%02ds",
+             index, total / 3600, (total % 3600) / 60, total % 60);
+    return (fs::path(options.outputDir) / (buffer + extension)).string();
+}
+
+#ifdef HAVE_LIBAV
+
+// Packet-level implementation: a second demuxer follows the detection position and
+// keeps compressed packets in a ring buffer, clips are stream-copied from it.
+struct ClipRecorder::Impl {
+    ClipOptions options;
+    std::string videoPath;
+
+    AVFormatContext* input = nullptr;
+    int videoStream = -1;
+    std::vector<int> streamMap;  // input stream -> clip stream, -1 if not copied
+    std::deque<AVPacket*> ring;
+    size_t ringBytes = 0;
+    uint64_t nextSeq = 0;        // sequence number of the next demuxed packet
+    uint64_t writtenSeq = 0;     // packets before this one are already in the open clip
+    double newestSeconds = 0;
+    bool eof = false;
+
+    AVFormatContext* output = nullptr;
+    bool headerWritten = false;
+    std::string clipPath;
+    double clipStart = 0;
+    double clipEnd = 0;
+    int clipCount = 0;
+
+    double packetSeconds(const AVPacket* pkt) const {
+        const AVStream* stream = input->streams[pkt->stream_index];
+        int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+        if (ts == AV_NOPTS_VALUE) return newestSeconds;
+        if (stream->start_time != AV_NOPTS_VALUE) ts -= stream->start_time;
+        return ts * av_q2d(stream->time_base);
+    }
+
+    bool isVideoKeyframe(const AVPacket* pkt) const {
+        return pkt->stream_index == videoStream && (pkt->flags & AV_PKT_FLAG_KEY);
+    }
+
+    uint64_t ringFirstSeq() const {
+        return nextSeq - ring.size();
+    }
+
+    void dropFront(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            AVPacket* pkt = ring.front();
+            ringBytes -= pkt->size;
+            av_packet_free(&pkt);
+            ring.pop_front();
+        }
+    }
+
+    // Drops whole GOPs from the front so the ring always starts on a video keyframe.
+    // The newest GOP is never dropped, even if it alone exceeds maxBufferBytes.
+    void trimRing() {
+        const double horizon = newestSeconds - options.preRollSeconds;
+        while (true) {
+            size_t nextKeyframe = 0;
+            for (size_t i = 1; i < ring.size(); ++i) {
+                if (isVideoKeyframe(ring[i])) {
+                    nextKeyframe = i;
+                    break;
+                }
+            }
+            if (nextKeyframe == 0) break;
+            if (packetSeconds(ring[nextKeyframe]) > horizon && ringBytes <= options.maxBufferBytes) break;
+            dropFront(nextKeyframe);
+        }
+    }
+
+    void writePacket(const AVPacket* src) {
+        AVPacket* pkt = av_packet_clone(src);
+        if (!pkt) return;
+
+        const AVStream* in = input->streams[src->stream_index];
+        const AVStream* out = output->streams[streamMap[src->stream_index]];
+        int64_t offset = std::llround(clipStart / av_q2d(in->time_base));
+        if (in->start_time != AV_NOPTS_VALUE) offset += in->start_time;
+        if (pkt->pts != AV_NOPTS_VALUE) pkt->pts -= offset;
+        if (pkt->dts != AV_NOPTS_VALUE) pkt->dts -= offset;
+        av_packet_rescale_ts(pkt, in->time_base, out->time_base);
+        pkt->stream_index = out->index;
+        pkt->pos = -1;
+
+        if (av_interleaved_write_frame(output, pkt) < 0) {
+            std::cerr << "Failed to write packet to clip: " << clipPath << "\n";
+        }
+        av_packet_free(&pkt);
+    }
+
+    void closeClip() {
+        if (!output) return;
+        if (headerWritten) {
+            av_write_trailer(output);
+            std::cout << "Clip saved: " << clipPath << " ("
+                      << formatTimestamp(clipStart) << " - " << formatTimestamp(std::min(clipEnd, newestSeconds)) << ")\n";
+        }
+        if (!(output->oformat->flags & AVFMT_NOFILE)) avio_closep(&output->pb);
+        avformat_free_context(output);
+        output = nullptr;
+        headerWritten = false;
+    }
+
+    bool openClip(double eventSeconds) {
+        clipPath = clipFilename(options, videoPath, ++clipCount, eventSeconds);
+        if (avformat_alloc_output_context2(&output, nullptr, nullptr, clipPath.c_str()) < 0 || !output) {
+            std::cerr << "Failed to create clip: " << clipPath << "\n";
+            output = nullptr;
+            return false;
+        }
+
+        for (unsigned i = 0; i < input->nb_streams; ++i) {
+            if (streamMap[i] < 0) continue;
+            AVStream* stream = avformat_new_stream(output, nullptr);
+            if (!stream || avcodec_parameters_copy(stream->codecpar, input->streams[i]->codecpar) < 0) {
+                std::cerr << "Failed to set up clip stream: " << clipPath << "\n";
+                closeClip();
+                return false;
+            }
+            stream->codecpar->codec_tag = 0;
+            stream->time_base = input->streams[i]->time_base;
+        }
+        output->avoid_negative_ts = AVFMT_AVOID_NEG_TS_MAKE_ZERO;
+
+        if (!(output->oformat->flags & AVFMT_NOFILE) &&
+            avio_open(&output->pb, clipPath.c_str(), AVIO_FLAG_WRITE) < 0) {
+            std::cerr << "Failed to open clip file: " << clipPath << "\n";
+            closeClip();
+            return false;
+        }
+        if (avformat_write_header(output, nullptr) < 0) {
+            std::cerr << "Failed to write clip header: " << clipPath << "\n";
+            closeClip();
+            return false;
+        }
+        headerWritten = true;
+
+        clipStart = ring.empty() ? eventSeconds : std::max(0.0, packetSeconds(ring.front()));
+        for (const AVPacket* pkt : ring) writePacket(pkt);
+        writtenSeq = nextSeq;
+        return true;
+    }
+
+    // Appends the packets held back after clipEnd, so an event whose pre-roll reaches
+    // into the open clip continues it. Fails if the ring cap already dropped some of them.
+    bool extendClip() {
+        if (!output || writtenSeq < ringFirstSeq()) return false;
+        for (size_t i = writtenSeq - ringFirstSeq(); i < ring.size(); ++i) writePacket(ring[i]);
+        writtenSeq = nextSeq;
+        return true;
+    }
+
+    // Demuxes until the newest video packet reaches the given time
+    void readUntil(double seconds) {
+        while (!eof && newestSeconds < seconds) {
+            AVPacket* pkt = av_packet_alloc();
+            if (!pkt || av_read_frame(input, pkt) < 0) {
+                av_packet_free(&pkt);
+                eof = true;
+                break;
+            }
+            if (pkt->stream_index >= static_cast<int>(streamMap.size()) || streamMap[pkt->stream_index] < 0) {
+                av_packet_free(&pkt);
+                continue;
+            }
+
+            if (pkt->stream_index == videoStream) {
+                newestSeconds = std::max(newestSeconds, packetSeconds(pkt));
+            }
+            // Past clipEnd packets are held back in the ring: the clip is kept open for another
+            // pre-roll in case the next event overlaps it
+            if (output && newestSeconds > clipEnd + options.preRollSeconds) closeClip();
+            if (output && newestSeconds <= clipEnd && writtenSeq == nextSeq) {
+                writePacket(pkt);
+                writtenSeq++;
+            }
+
+            ring.push_back(pkt);
+            nextSeq++;
+            ringBytes += pkt->size;
+            trimRing();
+        }
+    }
+};
+
+ClipRecorder::ClipRecorder(const std::string& videoPath, const ClipOptions& options)
+    : impl(std::make_unique<Impl>()) {
+    impl->options = options;
+    impl->videoPath = videoPath;
+    fs::create_directories(options.outputDir);
+
+    if (avformat_open_input(&impl->input, videoPath.c_str(), nullptr, nullptr) < 0) {
+        std::cerr << "Clip recorder: cannot open " << videoPath << "\n";
+        impl->input = nullptr;
+        return;
+    }
+    if (avformat_find_stream_info(impl->input, nullptr) < 0 ||
+        (impl->videoStream = av_find_best_stream(impl->input, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0)) < 0) {
+        std::cerr << "Clip recorder: no video stream in " << videoPath << "\n";
+        avformat_close_input(&impl->input);
+        return;
+    }
+
+    // Video and audio are copied into clips, other streams (subtitles, data) are skipped
+    int next = 0;
+    impl->streamMap.assign(impl->input->nb_streams, -1);
+    for (unsigned i = 0; i < impl->input->nb_streams; ++i) {
+        if (static_cast<int>(i) == impl->videoStream ||
+            impl->input->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+            impl->streamMap[i] = next++;
+        }
+    }
+}
+
+ClipRecorder::~ClipRecorder() {
+    finish();
+    impl->dropFront(impl->ring.size());
+    if (impl->input) avformat_close_input(&impl->input);
+}
+
+bool ClipRecorder::isOpen() const {
+    return impl->input != nullptr;
+}
+
+void ClipRecorder::advanceTo(double seconds) {
+    if (!impl->input) return;
+    impl->readUntil(seconds);
+}
+
+void ClipRecorder::trigger(double seconds) {
+    if (!impl->input) return;
+    impl->readUntil(seconds);
+
+    const double start = seconds - impl->options.preRollSeconds;
+    const double end = seconds + impl->options.postRollSeconds;
+    if (impl->output && start <= impl->clipEnd && impl->extendClip()) {
+        impl->clipEnd = std::max(impl->clipEnd, end);
+        return;
+    }
+    impl->closeClip();
+    if (impl->openClip(seconds)) impl->clipEnd = end;
+}
+
+void ClipRecorder::finish() {
+    if (!impl->output) return;
+    impl->readUntil(impl->clipEnd);
+    impl->closeClip();
+}
+
+#else
+
+// Fallback without FFmpeg libraries: merged event windows are cut with the ffmpeg CLI
+// as soon as detection has passed them. Each cut seeks into the source, so the file
+// is still not rewritten as a whole.
+struct ClipRecorder::Impl {
+    ClipOptions options;
+    std::string videoPath;
+    bool pending = false;
+    double clipStart = 0;
+    double clipEnd = 0;
+    double eventTime = 0;
+    int clipCount = 0;
+
+    void cutClip() {
+        pending = false;
+        std::string filename = clipFilename(options, videoPath, ++clipCount, eventTime);
+
+        std::ostringstream cmd;
+        cmd << "ffmpeg -ss " << clipStart << " -i \"" << videoPath << "\" -t " << (clipEnd - clipStart)
+            << " -c copy \"" << filename << "\" -y";
+        if (system(cmd.str().c_str()) != 0) {
+            std::cerr << "Failed to cut clip: " << filename << "\n";
+        } else {
+            std::cout << "Clip saved: " << filename << "\n";
+        }
+    }
+};
+
+ClipRecorder::ClipRecorder(const std::string& videoPath, const ClipOptions& options)
+    : impl(std::make_unique<Impl>()) {
+    impl->options = options;
+    impl->videoPath = videoPath;
+    fs::create_directories(options.outputDir);
+}
+
+ClipRecorder::~ClipRecorder() {
+    finish();
+}
+
+bool ClipRecorder::isOpen() const {
+    return true;
+}
+
+// The window stays pending for another pre-roll, an event starting within it is merged
+void ClipRecorder::advanceTo(double seconds) {
+    if (impl->pending && seconds > impl->clipEnd + impl->options.preRollSeconds) impl->cutClip();
+}
+
+void ClipRecorder::trigger(double seconds) {
+    const double start = std::max(0.0, seconds - impl->options.preRollSeconds);
+    const double end = seconds + impl->options.postRollSeconds;
+
+    if (impl->pending && start <= impl->clipEnd) {
+        impl->clipEnd = std::max(impl->clipEnd, end);
+        return;
+    }
+    if (impl->pending) impl->cutClip();
+
+    impl->pending = true;
+    impl->clipStart = start;
+    impl->clipEnd = end;
+    impl->eventTime = seconds;
+}
+
+void ClipRecorder::finish() {
+    if (impl->pending) impl->cutClip();
+}
+
+#endif
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+
+struct ClipOptions {
+    std::string outputDir = "event_clips";
+    double preRollSeconds = 5.0;
+    double postRollSeconds = 10.0;
+    size_t maxBufferBytes = 64u * 1024 * 1024;  // hard cap for the pre-roll ring buffer
+};
+
+// Writes event clips as a side effect of the detection pass. Compressed packets of the
+// last preRollSeconds are kept in a bounded ring buffer; on trigger() the pre-roll and the
+// following postRollSeconds are stream-copied into a clip, overlapping events extend it.
+class ClipRecorder {
+public:
+    ClipRecorder(const std::string& videoPath, const ClipOptions& options);
+    ~ClipRecorder();
+
+    bool isOpen() const;
+    void advanceTo(double seconds);  // demux up to the current detection position
+    void trigger(double seconds);    // motion event at the given video time
+    void finish();                   // complete the open clip, if any
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
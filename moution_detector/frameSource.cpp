@@ -0,0 +1,342 @@
+#include "frameSource.h"
+#include <opencv2/opencv.hpp>
+#include <cmath>
+#include <iostream>
+
+#ifdef HAVE_LIBAV
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/display.h>
+#include <libswscale/swscale.h>
+}
+#endif
+
+struct FrameSource::Impl {
+    bool luma = false;
+
+    // VideoCapture fallback. The BGR image is released on every grab(), so images
+    // handed out by retrieveBgr() are never overwritten by later frames.
+    cv::VideoCapture cap;
+    cv::Mat bgr;
+    bool bgrValid = false;
+
+    bool retrieveCaptured() {
+        if (!bgrValid) bgrValid = cap.retrieve(bgr) && !bgr.empty();
+        return bgrValid;
+    }
+
+#ifdef HAVE_LIBAV
+    AVFormatContext* input = nullptr;
+    AVCodecContext* decoder = nullptr;
+    AVPacket* packet = nullptr;
+    AVFrame* frame = nullptr;
+    SwsContext* toGray = nullptr;
+    SwsContext* toBgr = nullptr;
+    SwsContext* toScaledBgr = nullptr;
+    cv::Mat grayBuffer;
+    cv::Mat rotatedGray;
+    int rotation = 0;  // clockwise degrees (0, 90, 180, 270) from the display matrix
+    int videoStream = -1;
+    bool draining = false;
+    double frameRate = 0;
+    double lastPosition = 0;
+
+    // 8-bit YUV layouts whose first plane is the gray image as is
+    static bool hasGrayPlane(int format) {
+        switch (format) {
+            case AV_PIX_FMT_YUV420P: case AV_PIX_FMT_YUVJ420P:
+            case AV_PIX_FMT_YUV422P: case AV_PIX_FMT_YUVJ422P:
+            case AV_PIX_FMT_YUV444P: case AV_PIX_FMT_YUVJ444P:
+            case AV_PIX_FMT_YUV440P: case AV_PIX_FMT_YUVJ440P:
+            case AV_PIX_FMT_YUV411P: case AV_PIX_FMT_YUV410P:
+            case AV_PIX_FMT_NV12: case AV_PIX_FMT_NV21:
+            case AV_PIX_FMT_GRAY8:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static bool isFullRange(const AVFrame* f) {
+        switch (f->format) {
+            case AV_PIX_FMT_YUVJ420P: case AV_PIX_FMT_YUVJ422P:
+            case AV_PIX_FMT_YUVJ444P: case AV_PIX_FMT_YUVJ440P:
+            case AV_PIX_FMT_GRAY8:
+                return true;
+            default:
+                return f->color_range == AVCOL_RANGE_JPEG;
+        }
+    }
+
+    // Clockwise rotation the stream asks the player to apply, rounded to whole degrees
+    // in 0..359, as VideoCapture and ffplay interpret the display matrix
+    static long displayRotation(const AVStream* stream) {
+        const int32_t* matrix = nullptr;
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(60, 29, 100)
+        const AVPacketSideData* side = av_packet_side_data_get(stream->codecpar->coded_side_data,
+                                                               stream->codecpar->nb_coded_side_data,
+                                                               AV_PKT_DATA_DISPLAYMATRIX);
+        if (side && side->size >= 9 * sizeof(int32_t)) matrix = reinterpret_cast<const int32_t*>(side->data);
+#else
+#if LIBAVFORMAT_VERSION_MAJOR >= 59
+        size_t size = 0;
+#else
+        int size = 0;
+#endif
+        const uint8_t* data = av_stream_get_side_data(stream, AV_PKT_DATA_DISPLAYMATRIX, &size);
+        if (data && static_cast<size_t>(size) >= 9 * sizeof(int32_t)) matrix = reinterpret_cast<const int32_t*>(data);
+#endif
+        if (!matrix) return 0;
+        const double degrees = -av_display_rotation_get(matrix);
+        if (std::isnan(degrees)) return 0;
+        return ((std::lround(degrees) % 360) + 360) % 360;
+    }
+
+    int rotateCode() const {
+        return rotation == 90 ? cv::ROTATE_90_CLOCKWISE
+             : rotation == 180 ? cv::ROTATE_180 : cv::ROTATE_90_COUNTERCLOCKWISE;
+    }
+
+    bool openLuma(const std::string& path) {
+        if (avformat_open_input(&input, path.c_str(), nullptr, nullptr) < 0) {
+            input = nullptr;
+            return false;
+        }
+        if (avformat_find_stream_info(input, nullptr) < 0) return false;
+
+        videoStream = av_find_best_stream(input, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+        if (videoStream < 0) return false;
+        AVStream* stream = input->streams[videoStream];
+
+        // Zones from calibration and heatmap are in display orientation, so the planes are
+        // turned the same way. Anything but quarter turns is left to VideoCapture.
+        const long degrees = displayRotation(stream);
+        if (degrees % 90 != 0) return false;
+        rotation = static_cast<int>(degrees);
+
+        const AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+        if (!codec) return false;
+        decoder = avcodec_alloc_context3(codec);
+        if (!decoder || avcodec_parameters_to_context(decoder, stream->codecpar) < 0) return false;
+        decoder->thread_count = 0;  // decoder picks the number of threads
+        if (avcodec_open2(decoder, codec, nullptr) < 0) return false;
+
+        packet = av_packet_alloc();
+        frame = av_frame_alloc();
+        frameRate = av_q2d(av_guess_frame_rate(input, stream, nullptr));
+        return packet && frame;
+    }
+
+    void closeLuma() {
+        sws_freeContext(toGray);
+        sws_freeContext(toBgr);
+        sws_freeContext(toScaledBgr);
+        toGray = toBgr = toScaledBgr = nullptr;
+        av_frame_free(&frame);
+        av_packet_free(&packet);
+        avcodec_free_context(&decoder);
+        if (input) avformat_close_input(&input);
+    }
+
+    bool grabLuma() {
+        while (true) {
+            int rc = avcodec_receive_frame(decoder, frame);
+            if (rc == 0) break;
+            if (rc != AVERROR(EAGAIN)) return false;  // end of stream or decoder failure
+
+            if (av_read_frame(input, packet) < 0) {
+                if (draining) return false;
+                draining = true;
+                avcodec_send_packet(decoder, nullptr);
+                continue;
+            }
+            // A corrupt packet only costs its own frame, decoding goes on
+            if (packet->stream_index == videoStream) avcodec_send_packet(decoder, packet);
+            av_packet_unref(packet);
+        }
+
+        const AVStream* stream = input->streams[videoStream];
+        int64_t ts = frame->best_effort_timestamp;
+        if (ts != AV_NOPTS_VALUE) {
+            if (stream->start_time != AV_NOPTS_VALUE) ts -= stream->start_time;
+            lastPosition = ts * av_q2d(stream->time_base);
+        } else if (frameRate > 0) {
+            lastPosition += 1.0 / frameRate;
+        }
+        return true;
+    }
+
+    bool seekLuma(double seconds) {
+        const AVStream* stream = input->streams[videoStream];
+        int64_t ts = std::llround(seconds / av_q2d(stream->time_base));
+        if (stream->start_time != AV_NOPTS_VALUE) ts += stream->start_time;
+        if (av_seek_frame(input, videoStream, ts, AVSEEK_FLAG_BACKWARD) < 0) return false;
+        avcodec_flush_buffers(decoder);
+        draining = false;
+
+        // The seek lands on the previous keyframe, decode forward to the requested time
+        const double tolerance = frameRate > 0 ? 0.5 / frameRate : 0.001;
+        while (grabLuma()) {
+            if (lastPosition >= seconds - tolerance) return true;
+        }
+        return false;
+    }
+
+    bool grayLuma(cv::Mat& gray) {
+        const int w = frame->width, h = frame->height;
+        if (hasGrayPlane(frame->format) && frame->linesize[0] > 0) {
+            gray = cv::Mat(h, w, CV_8UC1, frame->data[0], static_cast<size_t>(frame->linesize[0]));
+        } else {
+            // High bit depth or packed formats: one cheap plane conversion, still no BGR
+            toGray = sws_getCachedContext(toGray, w, h, static_cast<AVPixelFormat>(frame->format),
+                                          w, h, AV_PIX_FMT_GRAY8, SWS_POINT, nullptr, nullptr, nullptr);
+            if (!toGray) return false;
+            grayBuffer.create(h, w, CV_8UC1);
+            uint8_t* dst[1] = {grayBuffer.data};
+            int dstStride[1] = {static_cast<int>(grayBuffer.step[0])};
+            sws_scale(toGray, frame->data, frame->linesize, 0, h, dst, dstStride);
+            gray = grayBuffer;
+        }
+
+        if (rotation) {
+            cv::rotate(gray, rotatedGray, rotateCode());
+            gray = rotatedGray;
+        }
+        return true;
+    }
+
+    // Separate contexts for full-size and scaled output, sws_getCachedContext would
+    // otherwise rebuild its filters whenever the two alternate
+    // size is in display orientation. Every call returns a new image, earlier ones may
+    // still be held by the proxy encoder.
+    bool bgrLuma(cv::Mat& out, SwsContext*& context, cv::Size size, int flags) {
+        const int w = frame->width, h = frame->height;
+        const cv::Size decoded = rotation % 180 ? cv::Size(size.height, size.width) : size;
+        context = sws_getCachedContext(context, w, h, static_cast<AVPixelFormat>(frame->format),
+                                       decoded.width, decoded.height, AV_PIX_FMT_BGR24, flags,
+                                       nullptr, nullptr, nullptr);
+        if (!context) return false;
+        cv::Mat converted(decoded, CV_8UC3);
+        uint8_t* dst[1] = {converted.data};
+        int dstStride[1] = {static_cast<int>(converted.step[0])};
+        sws_scale(context, frame->data, frame->linesize, 0, h, dst, dstStride);
+
+        if (rotation) {
+            cv::Mat rotated;
+            cv::rotate(converted, rotated, rotateCode());
+            out = rotated;
+        } else {
+            out = converted;
+        }
+        return true;
+    }
+#endif
+};
+
+FrameSource::FrameSource(const std::string& videoPath, bool preferLuma)
+    : impl(std::make_unique<Impl>()) {
+#ifdef HAVE_LIBAV
+    if (preferLuma) {
+        impl->luma = impl->openLuma(videoPath);
+        if (impl->luma) return;
+        impl->closeLuma();
+        std::cerr << "Luma decoding is not available for " << videoPath << ", using VideoCapture\n";
+    }
+#else
+    (void)preferLuma;
+#endif
+    impl->cap.open(videoPath);
+}
+
+FrameSource::~FrameSource() {
+#ifdef HAVE_LIBAV
+    impl->closeLuma();
+#endif
+}
+
+bool FrameSource::isOpened() const {
+    return impl->luma || impl->cap.isOpened();
+}
+
+bool FrameSource::usesLuma() const {
+    return impl->luma;
+}
+
+double FrameSource::fps() const {
+#ifdef HAVE_LIBAV
+    if (impl->luma) return impl->frameRate;
+#endif
+    return impl->cap.get(cv::CAP_PROP_FPS);
+}
+
+bool FrameSource::grab() {
+#ifdef HAVE_LIBAV
+    if (impl->luma) return impl->grabLuma();
+#endif
+    impl->bgr.release();
+    impl->bgrValid = false;
+    return impl->cap.grab();
+}
+
+bool FrameSource::seek(double seconds) {
+#ifdef HAVE_LIBAV
+    if (impl->luma) return impl->seekLuma(seconds);
+#endif
+    impl->cap.set(cv::CAP_PROP_POS_MSEC, seconds * 1000.0);
+    return grab();
+}
+
+bool FrameSource::retrieveGray(cv::Mat& gray) {
+#ifdef HAVE_LIBAV
+    if (impl->luma) return impl->grayLuma(gray);
+#endif
+    if (!impl->retrieveCaptured()) return false;
+    cv::cvtColor(impl->bgr, gray, cv::COLOR_BGR2GRAY);
+    return true;
+}
+
+bool FrameSource::retrieveBgr(cv::Mat& bgr) {
+#ifdef HAVE_LIBAV
+    if (impl->luma) return impl->bgrLuma(bgr, impl->toBgr, frameSize(), SWS_BILINEAR);
+#endif
+    if (!impl->retrieveCaptured()) return false;
+    bgr = impl->bgr;
+    return true;
+}
+
+bool FrameSource::retrieveBgr(cv::Mat& bgr, cv::Size size) {
+#ifdef HAVE_LIBAV
+    if (impl->luma) return impl->bgrLuma(bgr, impl->toScaledBgr, size, SWS_AREA);
+#else
+    (void)size;
+#endif
+    return retrieveBgr(bgr);
+}
+
+double FrameSource::positionSeconds() const {
+#ifdef HAVE_LIBAV
+    if (impl->luma) return impl->lastPosition;
+#endif
+    return impl->cap.get(cv::CAP_PROP_POS_MSEC) / 1000.0;
+}
+
+cv::Size FrameSource::frameSize() const {
+#ifdef HAVE_LIBAV
+    if (impl->luma) {
+        const cv::Size decoded(impl->frame->width, impl->frame->height);
+        return impl->rotation % 180 ? cv::Size(decoded.height, decoded.width) : decoded;
+    }
+#endif
+    return cv::Size(static_cast<int>(impl->cap.get(cv::CAP_PROP_FRAME_WIDTH)),
+                    static_cast<int>(impl->cap.get(cv::CAP_PROP_FRAME_HEIGHT)));
+}
+
+double FrameSource::grayContrast() const {
+#ifdef HAVE_LIBAV
+    if (impl->luma && Impl::hasGrayPlane(impl->frame->format) && !Impl::isFullRange(impl->frame)) {
+        return 219.0 / 255.0;
+    }
+#endif
+    return 1.0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <opencv2/core.hpp>
+#include <memory>
+#include <string>
+
+// Sequential frame reader for the detection loop. With FFmpeg libraries the gray image
+// is the decoder's own luma plane (no color conversion at all); BGR is only produced
+// when retrieveBgr() is called. Without them, or with preferLuma = false, it falls back
+// to VideoCapture and converts BGR to gray, but only for frames that are retrieved.
+// Both paths return frames in display orientation: quarter-turn rotation metadata is
+// applied to the luma plane, other rotations fall back to VideoCapture.
+class FrameSource {
+public:
+    FrameSource(const std::string& videoPath, bool preferLuma = true);
+    ~FrameSource();
+
+    bool isOpened() const;
+    bool usesLuma() const;
+    double fps() const;
+
+    bool grab();                        // decode the next frame without converting it
+    bool seek(double seconds);          // grab the first frame at or after the given time
+    bool retrieveGray(cv::Mat& gray);   // valid until the next grab(); may point into the decoder
+    bool retrieveBgr(cv::Mat& bgr);     // never overwritten by later grab() calls
+    // Same, scaled down to size in the same swscale pass as the color conversion. The
+    // VideoCapture fallback already has the full BGR frame and returns it unscaled.
+    bool retrieveBgr(cv::Mat& bgr, cv::Size size);
+    double positionSeconds() const;     // timestamp of the grabbed frame
+    cv::Size frameSize() const;
+
+    // Luma of limited-range video spans 16..235 instead of 0..255, so differences are
+    // smaller by this factor than in the BGR-derived gray image. Valid after grab().
+    double grayContrast() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
@@ -0,0 +1,139 @@
+#include "heatmap.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+
+static bool readSmallGray(cv::VideoCapture& cap, const cv::Size& size, cv::Mat& gray) {
+    cv::Mat frame;
+    if (!cap.read(frame) || frame.empty()) return false;
+
+    cv::Mat small;
+    cv::resize(frame, small, size, 0, 0, cv::INTER_AREA);
+    cv::cvtColor(small, gray, cv::COLOR_BGR2GRAY);
+    return true;
+}
+
+static cv::Rect scaleRect(const cv::Rect& r, double scale, int padding, const cv::Size& bounds) {
+    cv::Rect full(cvFloor(r.x / scale) - padding,
+                  cvFloor(r.y / scale) - padding,
+                  cvCeil(r.width / scale) + 2 * padding,
+                  cvCeil(r.height / scale) + 2 * padding);
+    return full & cv::Rect(0, 0, bounds.width, bounds.height);
+}
+
+std::vector<cv::Rect> buildMotionHeatmap(const std::string& videoPath, const HeatmapOptions& options) {
+    cv::VideoCapture probe(videoPath);
+    if (!probe.isOpened()) {
+        std::cerr << "Error opening video file for heatmap: " << videoPath << "\n";
+        return {};
+    }
+
+    const int totalFrames = static_cast<int>(probe.get(cv::CAP_PROP_FRAME_COUNT));
+    const cv::Size fullSize(static_cast<int>(probe.get(cv::CAP_PROP_FRAME_WIDTH)),
+                            static_cast<int>(probe.get(cv::CAP_PROP_FRAME_HEIGHT)));
+    const int gap = std::max(1, options.frameGap);
+    if (totalFrames <= gap || fullSize.width <= 0 || fullSize.height <= 0) {
+        std::cerr << "Video is too short or has unknown size: " << videoPath << "\n";
+        return {};
+    }
+
+    const double scale = std::min(1.0, static_cast<double>(options.analysisWidth) / fullSize.width);
+    const cv::Size smallSize(std::max(1, cvRound(fullSize.width * scale)),
+                             std::max(1, cvRound(fullSize.height * scale)));
+
+    const int samples = std::max(1, std::min(options.samples, totalFrames - gap));
+    const int stride = std::max(1, (totalFrames - gap) / samples);
+
+    // Reference frame for the overlay, taken from the middle of the video
+    cv::Mat reference;
+    probe.set(cv::CAP_PROP_POS_FRAMES, totalFrames / 2);
+    probe >> reference;
+    probe.release();
+
+    cv::Mat energy = cv::Mat::zeros(smallSize, CV_32F);
+    int pairs = 0;
+    std::mutex energyMutex;
+
+    // Each worker owns a decoder and a contiguous block of samples so it only seeks forward
+    const int workers = std::max(1, std::min(cv::getNumThreads(), samples));
+    cv::parallel_for_(cv::Range(0, workers), [&](const cv::Range& range) {
+        for (int w = range.start; w < range.end; ++w) {
+            cv::VideoCapture cap(videoPath);
+            if (!cap.isOpened()) continue;
+
+            cv::Mat local = cv::Mat::zeros(smallSize, CV_32F);
+            int localPairs = 0;
+            cv::Mat first, second, diff, moving;
+
+            for (int i = samples * w / workers; i < samples * (w + 1) / workers; ++i) {
+                cap.set(cv::CAP_PROP_POS_FRAMES, i * stride);
+                if (!readSmallGray(cap, smallSize, first)) continue;
+                for (int g = 1; g < gap; ++g) cap.grab();
+                if (!readSmallGray(cap, smallSize, second)) continue;
+
+                cv::absdiff(first, second, diff);
+                cv::threshold(diff, moving, options.motionThreshold, 1, cv::THRESH_BINARY);
+                cv::accumulate(moving, local);
+                localPairs++;
+            }
+
+            std::lock_guard<std::mutex> lock(energyMutex);
+            energy += local;
+            pairs += localPairs;
+        }
+    });
+
+    if (pairs == 0) {
+        std::cerr << "No frame pairs could be read for heatmap\n";
+        return {};
+    }
+    energy /= pairs;
+
+    double peak = 0;
+    cv::minMaxLoc(energy, nullptr, &peak);
+
+    cv::Mat energy8u, colored;
+    energy.convertTo(energy8u, CV_8U, peak > 0 ? 255.0 / peak : 0.0);
+    cv::applyColorMap(energy8u, colored, cv::COLORMAP_JET);
+    cv::resize(colored, colored, fullSize, 0, 0, cv::INTER_LINEAR);
+    if (!reference.empty() && reference.size() == fullSize) {
+        cv::addWeighted(reference, 0.5, colored, 0.5, 0, colored);
+    }
+
+    std::vector<cv::Rect> zones;
+    if (peak > 0) {
+        cv::Mat mask = energy >= peak * options.zoneLevel;
+        cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(5, 5));
+        cv::morphologyEx(mask, mask, cv::MORPH_CLOSE, kernel);
+
+        std::vector<std::vector<cv::Point>> contours;
+        cv::findContours(mask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+
+        std::vector<std::pair<double, cv::Rect>> ranked;
+        for (const auto& contour : contours) {
+            cv::Rect box = cv::boundingRect(contour);
+            if (box.area() < 4) continue;  // isolated noisy pixels
+            ranked.emplace_back(cv::sum(energy(box))[0], box);
+        }
+        std::sort(ranked.begin(), ranked.end(),
+                  [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        for (const auto& item : ranked) {
+            cv::Rect zone = scaleRect(item.second, scale, 8, fullSize);
+            zones.push_back(zone);
+            cv::rectangle(colored, zone, cv::Scalar(255, 255, 255), 2);
+            cv::putText(colored, "Zone " + std::to_string(zones.size()), cv::Point(zone.x, std::max(15, zone.y - 8)),
+                        cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(255, 255, 255), 1);
+        }
+    }
+
+    if (cv::imwrite(options.imagePath, colored)) {
+        std::cout << "Motion heatmap saved as: " << options.imagePath
+                  << " (" << pairs << " frame pairs)\n";
+    } else {
+        std::cerr << "Failed to save heatmap: " << options.imagePath << "\n";
+    }
+
+    return zones;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+struct HeatmapOptions {
+    int samples = 200;               // frame pairs spread evenly over the whole video
+    int frameGap = 20;               // distance in frames between the two frames of a pair
+    int analysisWidth = 320;         // frames are downscaled to this width before differencing
+    int motionThreshold = 25;
+    double zoneLevel = 0.25;         // fraction of peak energy that counts as a motion zone
+    std::string imagePath = "motion_heatmap.jpg";
+};
+
+// Samples the video in parallel, accumulates per-pixel motion energy, writes the
+// heatmap image and returns suggested detection zones (full-resolution coordinates),
+// strongest first. Returns an empty vector on error or when no motion was found.
+std::vector<cv::Rect> buildMotionHeatmap(const std::string& videoPath, const HeatmapOptions& options);
@@ -0,0 +1,407 @@
+#include "jobQueue.h"
+#include "motionAnalysis.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static std::string readFile(const fs::path& path) {
+    std::ifstream in(path);
+    std::ostringstream content;
+    content << in.rdbuf();
+    return content.str();
+}
+
+static bool holdsClaim(const fs::path& lockFile, const std::string& claim) {
+    return readFile(lockFile) == claim + "\n";
+}
+
+// Keeps refreshing the modification time of a claim while its shard is processed,
+// so other workers can tell a live claim from one left behind by a crashed worker.
+// Once the lock holds someone else's claim the shard is lost and the keeper stops.
+class LeaseKeeper {
+public:
+    LeaseKeeper(const fs::path& lockFile, const std::string& claim, double leaseSeconds)
+        : lockFile(lockFile), claim(claim), interval(std::max(1.0, leaseSeconds / 4)) {
+        thread = std::thread([this] {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stopped.wait_for(lock, interval, [this] { return done; })) {
+                // A missing lock is being checked by a reclaiming worker right now
+                std::error_code ec;
+                if (!fs::exists(this->lockFile, ec)) continue;
+                if (!holdsClaim(this->lockFile, this->claim)) {
+                    lost = true;
+                    break;
+                }
+                // No explicit time: the file server stamps its own clock (UTIME_NOW)
+                ::utimensat(AT_FDCWD, this->lockFile.c_str(), nullptr, 0);
+            }
+        });
+    }
+
+    ~LeaseKeeper() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        stopped.notify_all();
+        thread.join();
+    }
+
+    bool isLost() const { return lost; }
+
+private:
+    fs::path lockFile;
+    std::string claim;
+    std::chrono::duration<double> interval;
+    std::mutex mutex;
+    std::condition_variable stopped;
+    bool done = false;
+    std::atomic<bool> lost{false};
+    std::thread thread;
+};
+
+static std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) return "";
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(begin, end - begin + 1);
+}
+
+// Seconds ("90", "90.5") or HH:MM:SS
+static bool parseTime(const std::string& text, double& seconds) {
+    int h, m;
+    double s;
+    char tail;
+    if (text.find(':') != std::string::npos) {
+        if (sscanf(text.c_str(), "%d:%d:%lf%c", &h, &m, &s, &tail) != 3) return false;
+        seconds = h * 3600 + m * 60 + s;
+        return true;
+    }
+    char* end = nullptr;
+    seconds = strtod(text.c_str(), &end);
+    return end != text.c_str() && *end == '\0';
+}
+
+// Splits "rest last" at the last whitespace
+static bool popLastToken(std::string& line, std::string& token) {
+    size_t pos = line.find_last_of(" \t");
+    if (pos == std::string::npos) return false;
+    token = line.substr(pos + 1);
+    line = trim(line.substr(0, pos));
+    return true;
+}
+
+static std::string jobDirectory(const JobOptions& options) {
+    return options.jobDir.empty() ? options.manifestPath + ".jobs" : options.jobDir;
+}
+
+static std::string shardName(size_t index) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "shard_%04zu", index + 1);
+    return buffer;
+}
+
+static std::string describe(const JobShard& shard) {
+    std::ostringstream text;
+    text << shard.videoPath;
+    if (shard.startSeconds > 0 || shard.endSeconds >= 0) {
+        text << " [" << formatTimestamp(shard.startSeconds) << " - "
+             << (shard.endSeconds >= 0 ? formatTimestamp(shard.endSeconds) : "end") << "]";
+    }
+    return text.str();
+}
+
+static std::string workerId() {
+    char host[256] = {};
+    if (gethostname(host, sizeof(host) - 1) != 0) snprintf(host, sizeof(host), "unknown");
+    return std::string(host) + "-" + std::to_string(getpid());
+}
+
+// O_EXCL creation is atomic on local filesystems and on NFSv3+
+static bool tryCreateLock(const fs::path& lockFile, const std::string& claim) {
+    int fd = ::open(lockFile.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0644);
+    if (fd < 0) return false;
+    std::string content = claim + "\n";
+    if (::write(fd, content.data(), content.size()) < 0) {
+        std::cerr << "Failed to write claim: " << lockFile << "\n";
+    }
+    ::close(fd);
+    return true;
+}
+
+// Age of a file by the clock of the server holding the job directory: it is compared
+// with a probe file stamped just now, so clock differences between workers do not matter.
+// Returns false when the file does not exist.
+static bool claimAge(const fs::path& file, const fs::path& probe, double& age) {
+    std::error_code ec;
+    auto modified = fs::last_write_time(file, ec);
+    if (ec) return false;
+
+    age = 0;  // without a reference the claim is treated as live
+    int fd = ::open(probe.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0) return true;
+    ::close(fd);
+    ::utimensat(AT_FDCWD, probe.c_str(), nullptr, 0);
+    auto now = fs::last_write_time(probe, ec);
+    fs::remove(probe, ec);
+    if (ec) return true;
+    age = std::chrono::duration<double>(now - modified).count();
+    return true;
+}
+
+// Moves an expired claim aside. Only one worker can win the rename. The winner then
+// checks the age of the file it actually moved (rename keeps the modification time),
+// so a fresh claim created after the first check is never mistaken for the expired one.
+// Returns true when the shard may be claimed again.
+static bool reclaimIfStale(const fs::path& lockFile, double leaseSeconds, const std::string& owner) {
+    const fs::path probe = lockFile.parent_path() / (".clock." + owner);
+    double age;
+    if (!claimAge(lockFile, probe, age)) return true;  // released in the meantime
+    if (age < leaseSeconds) return false;
+
+    std::error_code ec;
+    fs::path aside = lockFile;
+    aside += ".stale." + owner;
+    fs::rename(lockFile, aside, ec);
+    if (ec) return true;  // another worker reclaimed or released it first
+
+    if (claimAge(aside, probe, age) && age < leaseSeconds) {
+        // A fresh claim was moved. Put it back without replacing a claim created in the
+        // meantime; if there is one, the owner of the moved claim sees a foreign claim
+        // at its next heartbeat and abandons the shard.
+        if (::link(aside.c_str(), lockFile.c_str()) != 0 && errno != EEXIST) {
+            std::cerr << "Failed to restore claim " << lockFile << "\n";
+        }
+        fs::remove(aside, ec);
+        return false;
+    }
+    std::cout << "Reclaimed expired claim " << lockFile.filename().string() << " of "
+              << trim(readFile(aside)) << " (idle " << static_cast<int>(age) << " s)" << std::endl;
+    fs::remove(aside, ec);
+    return true;
+}
+
+// Removes the lock only while it still holds this worker's claim
+static void releaseClaim(const fs::path& lockFile, const std::string& claim) {
+    std::error_code ec;
+    if (holdsClaim(lockFile, claim)) fs::remove(lockFile, ec);
+}
+
+bool readManifest(const std::string& path, std::vector<JobShard>& shards) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        std::cerr << "Cannot open job manifest: " << path << "\n";
+        return false;
+    }
+
+    // Relative video paths are relative to the manifest, not to each worker's directory
+    const fs::path base = fs::path(path).parent_path();
+    auto resolve = [&base](const std::string& video) {
+        return fs::path(video).is_absolute() ? video : (base / video).lexically_normal().string();
+    };
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        line = trim(line);
+        if (line.empty() || line[0] == '#') continue;
+
+        JobShard shard;
+        std::string rest = line, endToken, startToken;
+        double start, end;
+        if (popLastToken(rest, endToken) && popLastToken(rest, startToken) && !rest.empty() &&
+            parseTime(startToken, start) && parseTime(endToken, end)) {
+            if (end <= start) {
+                std::cerr << path << ":" << lineNumber << ": end of range is not after its start\n";
+                return false;
+            }
+            shard.videoPath = resolve(rest);
+            shard.startSeconds = start;
+            shard.endSeconds = end;
+        } else {
+            shard.videoPath = resolve(line);
+        }
+        shards.push_back(shard);
+    }
+
+    if (shards.empty()) {
+        std::cerr << "Job manifest is empty: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool runJobWorker(const JobOptions& options, const ShardRunner& runShard) {
+    std::vector<JobShard> shards;
+    if (!readManifest(options.manifestPath, shards)) return false;
+
+    const fs::path dir = jobDirectory(options);
+    fs::create_directories(dir);
+    const std::string owner = workerId();
+    std::cout << "Worker " << owner << ": " << shards.size() << " shards, job directory " << dir.string() << std::endl;
+
+    // Shards claimed by other workers are checked again every quarter lease until they
+    // have a result, so a claim left by a crashed worker is taken over once it expires
+    const auto pollInterval = std::chrono::duration<double>(std::max(1.0, options.leaseSeconds / 4));
+    std::vector<bool> failedHere(shards.size(), false);
+    int processed = 0, failed = 0;
+
+    while (true) {
+        int claimedElsewhere = 0;
+        for (size_t i = 0; i < shards.size(); ++i) {
+            const std::string name = shardName(i);
+            const fs::path result = dir / (name + ".txt");
+            const fs::path lockFile = dir / (name + ".lock");
+            if (failedHere[i] || fs::exists(result)) continue;
+
+            const std::string claim = owner + " " + std::to_string(std::time(nullptr));
+            if (!tryCreateLock(lockFile, claim) &&
+                !(reclaimIfStale(lockFile, options.leaseSeconds, owner) && tryCreateLock(lockFile, claim))) {
+                claimedElsewhere++;
+                continue;
+            }
+
+            std::error_code ec;
+            // Another worker may have finished the shard between the check and the claim
+            if (fs::exists(result)) {
+                releaseClaim(lockFile, claim);
+                continue;
+            }
+
+            // Results and frames appear under their final names only when complete, so a
+            // reclaimed shard never mixes in frames of the worker that gave it up
+            const fs::path partial = dir / (name + ".txt.part." + owner);
+            const fs::path frames = dir / (name + "_frames");
+            const fs::path partialFrames = dir / (name + "_frames.part." + owner);
+            fs::remove_all(partialFrames, ec);
+            std::cout << "Shard " << name << ": " << describe(shards[i]) << std::endl;
+            bool ok, lost;
+            {
+                LeaseKeeper lease(lockFile, claim, options.leaseSeconds);
+                ok = runShard(shards[i], partial.string(), partialFrames.string());
+                lost = lease.isLost();
+            }
+            if (lost || !holdsClaim(lockFile, claim)) {
+                // Another worker took the shard over and publishes its own result
+                fs::remove(partial, ec);
+                fs::remove_all(partialFrames, ec);
+                std::cerr << "Discarding the result of " << name << ": its claim was taken over by another worker" << std::endl;
+                continue;
+            }
+            if (ok) {
+                fs::remove_all(frames, ec);
+                fs::rename(partialFrames, frames, ec);
+                ok = !ec;
+            }
+            if (ok) {
+                fs::rename(partial, result, ec);
+                ok = !ec;
+            }
+
+            if (ok) {
+                processed++;
+            } else {
+                // Left for other workers, this one does not retry it
+                failed++;
+                failedHere[i] = true;
+                fs::remove(partial, ec);
+                fs::remove_all(partialFrames, ec);
+                std::cerr << "Shard " << name << " failed, it stays in the queue" << std::endl;
+            }
+            releaseClaim(lockFile, claim);
+        }
+
+        if (claimedElsewhere == 0) break;
+        std::cout << "Waiting for " << claimedElsewhere << " shards claimed by other workers" << std::endl;
+        std::this_thread::sleep_for(pollInterval);
+    }
+
+    std::cout << "Worker " << owner << " finished: " << processed << " shards processed, "
+              << failed << " failed" << std::endl;
+    return failed == 0;
+}
+
+bool mergeJobResults(const JobOptions& options, double cooldownSeconds, const std::string& outputFile) {
+    std::vector<JobShard> shards;
+    if (!readManifest(options.manifestPath, shards)) return false;
+    const fs::path dir = jobDirectory(options);
+
+    std::vector<std::string> videos;  // manifest order
+    std::map<std::string, std::vector<int>> events;
+    std::vector<std::string> missing;
+
+    for (size_t i = 0; i < shards.size(); ++i) {
+        const fs::path result = dir / (shardName(i) + ".txt");
+        std::ifstream in(result);
+        if (!in.is_open()) {
+            missing.push_back(shardName(i));
+            continue;
+        }
+
+        const std::string& video = shards[i].videoPath;
+        if (std::find(videos.begin(), videos.end(), video) == videos.end()) videos.push_back(video);
+
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t pos = line.find("Motion detected at: ");
+            if (pos == std::string::npos) continue;
+            int h = 0, m = 0, s = 0;
+            if (sscanf(line.c_str() + pos + 20, "%d:%d:%d", &h, &m, &s) == 3) {
+                events[video].push_back(h * 3600 + m * 60 + s);
+            }
+        }
+    }
+
+    if (!missing.empty()) {
+        std::cerr << "Shards without results (" << missing.size() << "):";
+        for (const auto& name : missing) std::cerr << " " << name;
+        std::cerr << "\n";
+        return false;
+    }
+
+    std::ofstream out(outputFile);
+    if (!out.is_open()) {
+        std::cerr << "Error opening output file: " << outputFile << "\n";
+        return false;
+    }
+
+    // Neighbouring shards do not know about each other's events, so the cooldown is
+    // applied again over the combined, sorted list. Timestamps have one second resolution.
+    int total = 0;
+    for (const std::string& video : videos) {
+        std::vector<int>& times = events[video];
+        std::sort(times.begin(), times.end());
+        if (videos.size() > 1) out << "# " << video << "\n";
+
+        bool first = true;
+        int lastTime = 0;
+        for (int t : times) {
+            if (!first && t - lastTime < cooldownSeconds) continue;
+            out << "Motion detected at: " << formatTimestamp(t) << "\n";
+            first = false;
+            lastTime = t;
+            total++;
+        }
+    }
+
+    std::cout << "Merged " << shards.size() << " shards: " << total << " events saved to " << outputFile << std::endl;
+    return true;
+}
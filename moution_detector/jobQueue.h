@@ -0,0 +1,36 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+// One unit of work from the manifest: a whole video or a time range of it
+struct JobShard {
+    std::string videoPath;
+    double startSeconds = 0;
+    double endSeconds = -1;  // -1 = until the end of the video
+};
+
+struct JobOptions {
+    std::string manifestPath;
+    std::string jobDir;          // claims and results; default: <manifest>.jobs
+    double leaseSeconds = 600;   // claims not refreshed for this long are reclaimed
+};
+
+// Runs detection for one shard, writing motion_times-style lines to resultFile
+// and detection frames to framesDir. Returns false on failure.
+using ShardRunner = std::function<bool(const JobShard& shard, const std::string& resultFile,
+                                       const std::string& framesDir)>;
+
+// Manifest lines: "<video>" or "<video> <start> <end>", times in seconds or HH:MM:SS.
+// Empty lines and lines starting with '#' are ignored.
+bool readManifest(const std::string& path, std::vector<JobShard>& shards);
+
+// Claims shards through lock files in jobDir and processes them. Returns once every shard
+// has a result or failed in this worker; until then shards claimed by other workers are
+// polled every leaseSeconds / 4 and taken over when their claim expires.
+// Safe to run in many processes on many machines sharing the job directory.
+bool runJobWorker(const JobOptions& options, const ShardRunner& runShard);
+
+// Combines shard results in manifest order into outputFile, applying the cooldown
+// across shard boundaries. Fails if any shard has no result yet.
+bool mergeJobResults(const JobOptions& options, double cooldownSeconds, const std::string& outputFile);
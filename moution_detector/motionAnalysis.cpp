@@ -0,0 +1,30 @@
+#include "motionAnalysis.h"
+#include <opencv2/opencv.hpp>
+#include <cstdio>
+
+std::vector<std::vector<cv::Point>> findMotionContours(const cv::Mat& roiPrev, const cv::Mat& roiCurrent,
+                                                       int motionThreshold) {
+    static const cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
+
+    cv::Mat frameDiff;
+    cv::absdiff(roiPrev, roiCurrent, frameDiff);
+
+    cv::Mat thresholdDiff;
+    cv::threshold(frameDiff, thresholdDiff, motionThreshold, 255, cv::THRESH_BINARY);
+    cv::morphologyEx(thresholdDiff, thresholdDiff, cv::MORPH_OPEN, kernel);
+
+    std::vector<std::vector<cv::Point>> contours;
+    cv::findContours(thresholdDiff, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+    return contours;
+}
+
+std::string formatTimestamp(double seconds) {
+    int totalSecs = static_cast<int>(seconds);
+    int hours = totalSecs / 3600;
+    int minutes = (totalSecs % 3600) / 60;
+    int secs = totalSecs % 60;
+
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d", hours, minutes, secs);
+    return std::string(buffer);
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+// Thresholds the difference of two gray ROIs, removes speckle noise and returns
+// the external contours of the remaining motion regions
+std::vector<std::vector<cv::Point>> findMotionContours(const cv::Mat& roiPrev, const cv::Mat& roiCurrent,
+                                                       int motionThreshold);
+
+// HH:MM:SS as used in motion_times.txt ("Motion detected at: 00:02:45")
+std::string formatTimestamp(double seconds);
@@ -4,8 +4,16 @@
 #include <vector>
 #include <chrono>
 #include <filesystem>
+#include <memory>
 #include <unistd.h>
 #include "markCreator.h"
+#include "heatmap.h"
+#include "clipRecorder.h"
+#include "motionAnalysis.h"
+#include "sweep.h"
+#include "proxyWriter.h"
+#include "frameSource.h"
+#include "jobQueue.h"
 
 using namespace cv;
 using namespace std;
@@ -23,11 +31,30 @@ struct Settings {
     int minContourArea = 500;
     double cooldownSeconds = 20.0;
     bool calibrateMode = false;
+    bool heatmapMode = false;
+    int heatmapSamples = 200;
+    int heatmapZone = 0;             // zone number to write into calibrationFile, 0 = only print
+    string clipDir;                  // empty = event clips disabled
+    double preRollSeconds = 5.0;
+    double postRollSeconds = 10.0;
+    int clipBufferMB = 64;
+    string sweepGrid;                // empty = normal detection
+    string sweepDir = "sweep_results";
+    string proxyPath;                // empty = no review proxy
+    int proxyEveryNth = 1;
+    int proxyWidth = 640;
+    bool lumaDecode = true;          // gray straight from the decoder's Y plane when possible
+    double startSeconds = 0;         // analyzed time range, used by job shards
+    double endSeconds = -1;          // -1 = until the end of the video
+    string jobManifest;              // worker mode: claim and process shards from this manifest
+    string mergeManifest;            // merge shard results of this manifest into outputFile
+    double leaseSeconds = 600.0;
 };
 
 Settings settings;
 double lastDetectionTime = -settings.cooldownSeconds;
 int savedFrameCount = 0;
+double grayContrast = 1.0;  // motionThreshold scale for limited-range luma, see FrameSource
 bool exportChapters = false;
 bool removeChapters = false;
 std::string outputVideoWithChapters = "with_chapters.mp4";
@@ -48,9 +75,36 @@ void printHelp() {
          << "  -t <число>       Порог обнаружения движения (чувствительность, по умолчанию: 25)\n"
          << "  -a <число>       Минимальная площадь контура для учета (по умолчанию: 500)\n"
          << "  -C <число>       Время перезарядки между событиями в секундах (по умолчанию: 20.0)\n"
-         << "  -z               Режим калибровки (интерактивный выбор области движения)\n\n"
+         << "  -z               Режим калибровки (интерактивный выбор области движения)\n"
+         << "  -L               Декодировать через VideoCapture с BGR-кадрами вместо яркостной плоскости\n"
+         << "  -m               Режим тепловой карты: оценить движение по всему видео и предложить области\n"
+         << "  -n <число>       Количество пар кадров для тепловой карты (по умолчанию: 200)\n"
+         << "  -Z <номер>       Записать предложенную область с этим номером в calibration.dat\n"
+         << "                   (без опции области только выводятся)\n"
+         << "  -S <сетка>       Перебор параметров за одно декодирование, например \"t=15,25;a=300,500;s=10,20;C=10,20\".\n"
+         << "                   Не указанные параметры берутся из -t/-a/-s/-C. Логи и таблица сравнения\n"
+         << "                   сохраняются в папку sweep_results\n\n"
          << "  -M               Добавить главы в видео на основе лог-файла движения. Файл с метками залать по опции -o file.txt\n"
-         << "  -R               Удалить главы из видео (если они есть)\n";
+         << "  -R               Удалить главы из видео (если они есть)\n\n";
+
+    cout << "Запись клипов с событиями во время детекции:\n"
+         << "  -c <дир>         Папка для клипов; включает запись клипов (копирование без перекодирования)\n"
+         << "  -b <сек>         Секунд до события в клипе (pre-roll, по умолчанию: 5)\n"
+         << "  -A <сек>         Секунд после события в клипе (по умолчанию: 10)\n"
+         << "  -B <МБ>          Максимальный объем буфера pre-roll в мегабайтах (по умолчанию: 64)\n\n";
+
+    cout << "Прокси-видео для просмотра (кодируется в фоне во время детекции):\n"
+         << "  -P <файл>        Записать уменьшенное прокси-видео с областью детекции и метками событий\n"
+         << "  -k <число>       Кодировать каждый k-й декодированный кадр (по умолчанию: 1)\n"
+         << "  -W <число>       Ширина прокси в пикселях (по умолчанию: 640)\n\n";
+
+    cout << "Распределенная обработка через общую папку (NFS):\n"
+         << "  -J <манифест>    Режим воркера: захватывать и обрабатывать задания из манифеста.\n"
+         << "                   Строка манифеста: \"видео\" или \"видео начало конец\" (секунды или ЧЧ:ММ:СС).\n"
+         << "                   Захваты и результаты хранятся в папке <манифест>.jobs\n"
+         << "  -T <сек>         Срок аренды задания: захват без обновления дольше этого срока\n"
+         << "                   считается брошенным и забирается другим воркером (по умолчанию: 600)\n"
+         << "  -U <манифест>    Объединить результаты заданий в файл -o с учетом перезарядки на стыках\n\n";
 
     cout << "Параметры области обнаружения движения:\n"
          << "  -x <число>       Координата X левого верхнего угла (по умолчанию: 100)\n"
@@ -77,9 +131,15 @@ void printHelp() {
          << "  Запуск интерактивной калибровки:\n"
          << "    ./motion_detector -z -i /home/user/videos/video1.mp4\n\n"
 
+         << "  Построение тепловой карты движения и запись лучшей области в calibration.dat:\n"
+         << "    ./motion_detector -m -i /home/user/videos/video1.mp4 -Z 1\n\n"
+
          << "  Запуск с параметрами области после калибровки:\n"
          << "    ./motion_detector -i /home/user/videos/video1.mp4 -x 1150 -y 600 -w 600 -H 460\n\n"
 
+         << "  Подбор порога и площади для новой камеры за один проход по видео:\n"
+         << "    ./motion_detector -i video1.mp4 -S \"t=15,25,35;a=300,500,1000\"\n\n"
+
          << "  Увеличение чувствительности (понижение порога):\n"
          << "    ./motion_detector -t 15\n\n"
 
@@ -89,6 +149,16 @@ void printHelp() {
          << "  Установка времени перезарядки между событиями (например, 10 секунд):\n"
          << "    ./motion_detector -C 10\n\n"
          
+         << "  Запись клипов (7 секунд до и 15 после события) прямо во время детекции:\n"
+         << "    ./motion_detector -i input.mp4 -c clips -b 7 -A 15\n\n"
+
+         << "  Детекция с одновременной записью прокси 480 px (каждый 2-й кадр):\n"
+         << "    ./motion_detector -i input.mp4 -P proxy.mp4 -W 480 -k 2\n\n"
+
+         << "  Запуск воркеров на нескольких машинах и объединение результатов:\n"
+         << "    ./motion_detector -J /mnt/nfs/nightly.txt -s 10 -C 20\n"
+         << "    ./motion_detector -U /mnt/nfs/nightly.txt -C 20 -o motion_times.txt\n\n"
+
          << "  Добавление меток на видео:\n"
          << "    ./motion_detector -i input.mp4 -M -o timestamp_file.txt\n\n";
 
@@ -102,7 +172,7 @@ void printHelp() {
 
 void parseArguments(int argc, char** argv) {
     int opt;
-    while ((opt = getopt(argc, argv, "hi:o:d:s:t:a:C:x:y:w:H:zMR")) != -1) {
+    while ((opt = getopt(argc, argv, "hi:o:d:s:t:a:C:x:y:w:H:zLmn:Z:S:c:b:A:B:P:k:W:J:T:U:MR")) != -1) {
         try {
             switch (opt) {
                 case 'h':
@@ -144,6 +214,51 @@ void parseArguments(int argc, char** argv) {
                 case 'z':
                     settings.calibrateMode = true;
                     break;
+                case 'L':
+                    settings.lumaDecode = false;
+                    break;
+                case 'm':
+                    settings.heatmapMode = true;
+                    break;
+                case 'n':
+                    settings.heatmapSamples = stoi(optarg);
+                    break;
+                case 'Z':
+                    settings.heatmapZone = stoi(optarg);
+                    break;
+                case 'S':
+                    settings.sweepGrid = optarg;
+                    break;
+                case 'c':
+                    settings.clipDir = optarg;
+                    break;
+                case 'b':
+                    settings.preRollSeconds = stod(optarg);
+                    break;
+                case 'A':
+                    settings.postRollSeconds = stod(optarg);
+                    break;
+                case 'B':
+                    settings.clipBufferMB = stoi(optarg);
+                    break;
+                case 'P':
+                    settings.proxyPath = optarg;
+                    break;
+                case 'k':
+                    settings.proxyEveryNth = stoi(optarg);
+                    break;
+                case 'W':
+                    settings.proxyWidth = stoi(optarg);
+                    break;
+                case 'J':
+                    settings.jobManifest = optarg;
+                    break;
+                case 'T':
+                    settings.leaseSeconds = stod(optarg);
+                    break;
+                case 'U':
+                    settings.mergeManifest = optarg;
+                    break;
                 case '?':
                     cerr << "Unknown option or missing argument." << endl;
                     exit(1);
@@ -164,18 +279,6 @@ void parseArguments(int argc, char** argv) {
     }
 }
 
-string formatTimestamp(double seconds) {
-    int totalSecs = static_cast<int>(seconds);
-    int hours = totalSecs / 3600;
-    int minutes = (totalSecs % 3600) / 60;
-    int secs = totalSecs % 60;
-
-    char buffer[16];
-    snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d", hours, minutes, secs);
-    return string(buffer);
-}
-
-
 void saveCalibration() {
     ofstream calFile(settings.calibrationFile);
     if (calFile.is_open()) {
@@ -258,23 +361,14 @@ bool isCoolingDown(double currentTime) {
     return (currentTime - lastDetectionTime) < settings.cooldownSeconds;
 }
 
-void detectMotion(const Mat& grayPrev, const Mat& grayCurrent, const Mat& originalFrame, ofstream& outFile, double timestamp) {
-    if (isCoolingDown(timestamp)) return;
+bool detectMotion(const Mat& grayPrev, const Mat& grayCurrent, FrameSource& source, ofstream& outFile, double timestamp) {
+    if (isCoolingDown(timestamp)) return false;
 
     Mat roiPrev = grayPrev(settings.detectionArea);
     Mat roiCurrent = grayCurrent(settings.detectionArea);
 
-    Mat frameDiff;
-    absdiff(roiPrev, roiCurrent, frameDiff);
-
-    Mat thresholdDiff;
-    threshold(frameDiff, thresholdDiff, settings.motionThreshold, 255, THRESH_BINARY);
-
-    Mat kernel = getStructuringElement(MORPH_RECT, Size(3, 3));
-    morphologyEx(thresholdDiff, thresholdDiff, MORPH_OPEN, kernel);
-
-    vector<vector<Point>> contours;
-    findContours(thresholdDiff, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
+    int scaledThreshold = cvRound(settings.motionThreshold * grayContrast);
+    vector<vector<Point>> contours = findMotionContours(roiPrev, roiCurrent, scaledThreshold);
 
     for (const auto& contour : contours) {
         if (contourArea(contour) > settings.minContourArea) {
@@ -282,40 +376,46 @@ void detectMotion(const Mat& grayPrev, const Mat& grayCurrent, const Mat& origin
             string timeStr = formatTimestamp(timestamp);
             outFile << "Motion detected at: " << timeStr << endl;
             cout << "Motion detected at: " << timeStr << endl;
-            saveDetectionFrame(originalFrame, timestamp);
-            break;
+
+            // The only place the detection loop needs a color frame
+            Mat originalFrame;
+            if (source.retrieveBgr(originalFrame)) saveDetectionFrame(originalFrame, timestamp);
+            return true;
         }
     }
+    return false;
 }
 
-void runDetection() {
+bool runDetection() {
     ensureDirectoryExists(settings.saveDir);
     loadCalibration();
 
-    VideoCapture cap(settings.videoPath);
-    if (!cap.isOpened()) {
+    FrameSource source(settings.videoPath, settings.lumaDecode);
+    if (!source.isOpened()) {
         cerr << "Error opening video file: " << settings.videoPath << endl;
-        exit(1);
+        return false;
     }
 
     ofstream outFile(settings.outputFile);
     if (!outFile.is_open()) {
         cerr << "Error opening output file: " << settings.outputFile << endl;
-        exit(1);
+        return false;
     }
 
-    Mat prevFrame;
-    cap >> prevFrame;
-    if (prevFrame.empty()) {
+    Mat firstGray;
+    bool positioned = settings.startSeconds > 0 ? source.seek(settings.startSeconds) : source.grab();
+    if (!positioned || !source.retrieveGray(firstGray)) {
         cerr << "Error reading first frame" << endl;
-        exit(1);
+        return false;
     }
 
+    // retrieveGray() may point into the decoder, grayPrev needs its own copy
     Mat grayPrev;
-    cvtColor(prevFrame, grayPrev, COLOR_BGR2GRAY);
+    firstGray.copyTo(grayPrev);
+    grayContrast = source.grayContrast();
 
     int frameCount = 0;
-    double fps = cap.get(CAP_PROP_FPS);
+    double fps = source.fps();
     if (fps <= 0) fps = 30;
 
     cout << "Starting motion detection with settings:" << endl;
@@ -326,29 +426,145 @@ void runDetection() {
     cout << "  Motion threshold: " << settings.motionThreshold << endl;
     cout << "  Min contour area: " << settings.minContourArea << endl;
     cout << "  Cooldown: " << settings.cooldownSeconds << " seconds" << endl;
+    cout << "  Decoding: " << (source.usesLuma() ? "luma plane" : "VideoCapture (BGR)") << endl;
+
+    unique_ptr<ClipRecorder> clips;
+    if (!settings.clipDir.empty()) {
+        ClipOptions clipOptions;
+        clipOptions.outputDir = settings.clipDir;
+        clipOptions.preRollSeconds = settings.preRollSeconds;
+        clipOptions.postRollSeconds = settings.postRollSeconds;
+        clipOptions.maxBufferBytes = static_cast<size_t>(settings.clipBufferMB) * 1024 * 1024;
+        clips = make_unique<ClipRecorder>(settings.videoPath, clipOptions);
+        if (!clips->isOpen()) clips.reset();
+        cout << "  Event clips: " << (clips ? settings.clipDir : "disabled") << endl;
+    }
 
-    while (true) {
-        Mat currentFrame;
-        cap >> currentFrame;
-        if (currentFrame.empty()) break;
+    unique_ptr<ProxyWriter> proxy;
+    if (!settings.proxyPath.empty()) {
+        ProxyOptions proxyOptions;
+        proxyOptions.path = settings.proxyPath;
+        proxyOptions.width = settings.proxyWidth;
+        proxyOptions.everyNth = settings.proxyEveryNth;
+        proxy = make_unique<ProxyWriter>(proxyOptions, fps, source.frameSize(), settings.detectionArea);
+        if (!proxy->isOpen()) proxy.reset();
+        cout << "  Review proxy: " << (proxy ? settings.proxyPath : "disabled") << endl;
+        if (proxy) {
+            Mat firstFrame;
+            source.retrieveBgr(firstFrame, proxy->frameSize());
+            proxy->push(firstFrame, source.positionSeconds());
+        }
+    }
+
+    // Skipped frames are only grabbed: no gray or color conversion at all
+    while (source.grab()) {
+        if (settings.endSeconds >= 0 && source.positionSeconds() > settings.endSeconds) break;
 
         frameCount++;
-        if (frameCount % settings.frameSkip != 0) continue;
+        if (frameCount % settings.frameSkip == 0) {
+            double timestamp = source.positionSeconds();
 
-        double timestamp = cap.get(CAP_PROP_POS_MSEC) / 1000.0;
+            Mat grayCurrent;
+            if (!source.retrieveGray(grayCurrent)) break;
 
-        Mat grayCurrent;
-        cvtColor(currentFrame, grayCurrent, COLOR_BGR2GRAY);
+            if (clips) clips->advanceTo(timestamp);
+            if (detectMotion(grayPrev, grayCurrent, source, outFile, timestamp)) {
+                if (clips) clips->trigger(timestamp);
+                if (proxy) proxy->markEvent();
+            }
 
-        detectMotion(grayPrev, grayCurrent, currentFrame, outFile, timestamp);
+            grayCurrent.copyTo(grayPrev);
+        }
 
-        grayCurrent.copyTo(grayPrev);
+        if (proxy) {
+            Mat proxyFrame;
+            if (proxy->wantsNextFrame()) source.retrieveBgr(proxyFrame, proxy->frameSize());
+            proxy->push(proxyFrame, source.positionSeconds());
+        }
     }
 
-    cap.release();
+    if (proxy) proxy->finish();
+    if (clips) clips->finish();
     outFile.close();
     cout << "Processing complete. Results saved to " << settings.outputFile << endl;
     cout << "Detection frames saved in: " << settings.saveDir << endl;
+    return true;
+}
+
+bool runHeatmap() {
+    HeatmapOptions options;
+    options.samples = settings.heatmapSamples;
+    options.frameGap = settings.frameSkip;
+    options.motionThreshold = settings.motionThreshold;
+
+    cout << "Building motion heatmap from " << options.samples << " frame pairs..." << endl;
+    vector<Rect> zones = buildMotionHeatmap(settings.videoPath, options);
+    if (zones.empty()) {
+        cerr << "No motion zones found" << endl;
+        return false;
+    }
+
+    cout << "Suggested detection zones (strongest first):" << endl;
+    for (size_t i = 0; i < zones.size(); ++i) {
+        cout << "  Zone " << i + 1 << ": -x " << zones[i].x
+             << " -y " << zones[i].y
+             << " -w " << zones[i].width
+             << " -H " << zones[i].height << endl;
+    }
+
+    // An existing calibration may be hand-tuned, it is only replaced on request
+    if (settings.heatmapZone <= 0) {
+        cout << "Use -Z <zone> to write a zone into " << settings.calibrationFile << endl;
+        return true;
+    }
+    if (settings.heatmapZone > static_cast<int>(zones.size())) {
+        cerr << "No zone " << settings.heatmapZone << ", only " << zones.size() << " suggested" << endl;
+        return false;
+    }
+    settings.detectionArea = zones[settings.heatmapZone - 1];
+    saveCalibration();
+    return true;
+}
+
+bool runSweep() {
+    loadCalibration();
+
+    SweepConfig base{settings.frameSkip, settings.motionThreshold, settings.minContourArea, settings.cooldownSeconds};
+    vector<SweepConfig> configs;
+    if (!parseSweepGrid(settings.sweepGrid, base, configs)) return false;
+    return runParameterSweep(settings.videoPath, settings.detectionArea, configs, settings.sweepDir, settings.lumaDecode);
+}
+
+bool runShard(const JobShard& shard, const string& resultFile, const string& framesDir) {
+    Settings saved = settings;
+    settings.videoPath = shard.videoPath;
+    settings.startSeconds = shard.startSeconds;
+    settings.endSeconds = shard.endSeconds;
+    settings.outputFile = resultFile;
+    settings.saveDir = framesDir;
+    // Clips and proxies of different workers would overwrite each other
+    settings.clipDir.clear();
+    settings.proxyPath.clear();
+
+    lastDetectionTime = -settings.cooldownSeconds;
+    savedFrameCount = 0;
+    bool ok = runDetection();
+
+    settings = saved;
+    return ok;
+}
+
+bool runJobs() {
+    JobOptions options;
+    options.manifestPath = settings.jobManifest;
+    options.leaseSeconds = settings.leaseSeconds;
+    return runJobWorker(options, runShard);
+}
+
+bool mergeJobs() {
+    JobOptions options;
+    options.manifestPath = settings.mergeManifest;
+    return mergeJobResults(options, settings.cooldownSeconds, settings.outputFile);
 }
 
 // Helpers made global so onMouse can use them
@@ -456,8 +672,16 @@ int main(int argc, char** argv) {
         if (settings.calibrateMode) {
             // runCalibration();
             interactiveCalibration();
+        } else if (settings.heatmapMode) {
+            if (!runHeatmap()) return 1;
+        } else if (!settings.sweepGrid.empty()) {
+            if (!runSweep()) return 1;
+        } else if (!settings.jobManifest.empty()) {
+            if (!runJobs()) return 1;
+        } else if (!settings.mergeManifest.empty()) {
+            if (!mergeJobs()) return 1;
         } else {
-            runDetection();
+            if (!runDetection()) return 1;
         }
 
         if (exportChapters) {
@@ -0,0 +1,134 @@
+#include "proxyWriter.h"
+#include "motionAnalysis.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+struct ProxyFrame {
+    cv::Mat frame;
+    double seconds;   // source timestamp, matches motion_times.txt even for VFR video
+    bool motion;
+};
+
+struct ProxyWriter::Impl {
+    ProxyOptions options;
+    double sourceFps = 30;
+    cv::Size proxySize;
+    cv::Rect proxyArea;
+    double scale = 1;
+    cv::VideoWriter writer;
+
+    std::deque<ProxyFrame> queue;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool done = false;
+    std::thread encoder;
+
+    long frameIndex = 0;     // decoded frames seen by push()
+    long motionFrames = 0;   // decoded frames left to mark as motion
+
+    void encode(const ProxyFrame& item) {
+        // The overlay is drawn on a private copy, the pushed frame may be shared
+        cv::Mat small;
+        if (item.frame.size() == proxySize) item.frame.copyTo(small);
+        else cv::resize(item.frame, small, proxySize, 0, 0, cv::INTER_AREA);
+
+        const cv::Scalar color = item.motion ? cv::Scalar(0, 0, 255) : cv::Scalar(0, 255, 0);
+        cv::rectangle(small, proxyArea, color, item.motion ? 2 : 1);
+        if (item.motion) {
+            cv::rectangle(small, cv::Rect(0, 0, proxySize.width, proxySize.height), color, 4);
+            cv::putText(small, "MOTION", cv::Point(10, 25), cv::FONT_HERSHEY_SIMPLEX, 0.7, color, 2);
+        }
+        cv::putText(small, formatTimestamp(item.seconds), cv::Point(10, proxySize.height - 10),
+                    cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 255, 255), 1);
+        writer.write(small);
+    }
+
+    void run() {
+        while (true) {
+            ProxyFrame item;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this] { return done || !queue.empty(); });
+                if (queue.empty()) return;
+                item = std::move(queue.front());
+                queue.pop_front();
+            }
+            changed.notify_all();
+            encode(item);
+        }
+    }
+};
+
+ProxyWriter::ProxyWriter(const ProxyOptions& options, double sourceFps, cv::Size sourceSize,
+                         const cv::Rect& detectionArea)
+    : impl(std::make_unique<Impl>()) {
+    impl->options = options;
+    impl->options.everyNth = std::max(1, options.everyNth);
+    impl->options.queueLimit = std::max<size_t>(1, options.queueLimit);
+    impl->sourceFps = sourceFps;
+
+    // Even dimensions keep most encoders happy
+    int width = std::min(std::max(2, options.width), sourceSize.width) & ~1;
+    impl->scale = static_cast<double>(width) / sourceSize.width;
+    impl->proxySize = cv::Size(width, std::max(2, cvRound(sourceSize.height * impl->scale) & ~1));
+    impl->proxyArea = cv::Rect(cvRound(detectionArea.x * impl->scale), cvRound(detectionArea.y * impl->scale),
+                               cvRound(detectionArea.width * impl->scale), cvRound(detectionArea.height * impl->scale));
+
+    const double proxyFps = sourceFps / impl->options.everyNth;
+    if (!impl->writer.open(options.path, cv::VideoWriter::fourcc('m', 'p', '4', 'v'), proxyFps, impl->proxySize)) {
+        std::cerr << "Failed to open proxy video: " << options.path << "\n";
+        return;
+    }
+    impl->encoder = std::thread([this] { impl->run(); });
+}
+
+ProxyWriter::~ProxyWriter() {
+    finish();
+}
+
+bool ProxyWriter::isOpen() const {
+    return impl->writer.isOpened();
+}
+
+cv::Size ProxyWriter::frameSize() const {
+    return impl->proxySize;
+}
+
+bool ProxyWriter::wantsNextFrame() const {
+    return impl->encoder.joinable() && impl->frameIndex % impl->options.everyNth == 0;
+}
+
+void ProxyWriter::push(const cv::Mat& frame, double seconds) {
+    const long index = impl->frameIndex++;
+    const bool motion = impl->motionFrames > 0;
+    if (motion) impl->motionFrames--;
+
+    if (!impl->encoder.joinable() || frame.empty() || index % impl->options.everyNth != 0) return;
+
+    std::unique_lock<std::mutex> lock(impl->mutex);
+    impl->changed.wait(lock, [this] { return impl->queue.size() < impl->options.queueLimit; });
+    impl->queue.push_back({frame, seconds, motion});
+    lock.unlock();
+    impl->changed.notify_all();
+}
+
+void ProxyWriter::markEvent() {
+    impl->motionFrames = std::max(1L, static_cast<long>(impl->sourceFps));
+}
+
+void ProxyWriter::finish() {
+    if (!impl->encoder.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        impl->done = true;
+    }
+    impl->changed.notify_all();
+    impl->encoder.join();
+    impl->writer.release();
+    std::cout << "Review proxy saved as: " << impl->options.path << std::endl;
+}
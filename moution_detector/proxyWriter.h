@@ -0,0 +1,37 @@
+#pragma once
+#include <opencv2/core.hpp>
+#include <memory>
+#include <string>
+
+struct ProxyOptions {
+    std::string path = "proxy.mp4";
+    int width = 640;            // proxy width, height keeps the aspect ratio
+    int everyNth = 1;           // encode every k-th decoded frame
+    size_t queueLimit = 32;     // frames waiting for the encoder before push() blocks
+};
+
+// Low-resolution review proxy encoded on a background thread from the frames the
+// detector already decodes. Overlays the detection area and motion events.
+class ProxyWriter {
+public:
+    ProxyWriter(const ProxyOptions& options, double sourceFps, cv::Size sourceSize, const cv::Rect& detectionArea);
+    ~ProxyWriter();
+
+    bool isOpen() const;
+    // Size of the encoded frames. Pushing frames of this size keeps scaling off the
+    // caller's thread; larger frames are downscaled by the encoder thread.
+    cv::Size frameSize() const;
+    // True when the next pushed frame will be encoded, so callers can skip producing
+    // BGR for frames the proxy drops anyway
+    bool wantsNextFrame() const;
+    // Called for every decoded frame (an empty Mat for frames the proxy does not want)
+    // with its source timestamp, which is printed as the timecode.
+    // The frame is shared with the encoder thread, the caller must not write into it.
+    void push(const cv::Mat& frame, double seconds);
+    void markEvent();  // highlights the next second of the proxy as motion
+    void finish();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
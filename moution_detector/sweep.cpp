@@ -0,0 +1,191 @@
+#include "sweep.h"
+#include "motionAnalysis.h"
+#include "frameSource.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+struct SweepState {
+    SweepConfig config;
+    cv::Mat grayPrev;
+    double lastDetectionTime = 0;
+    std::vector<double> events;
+    int weakEvents = 0;        // largest contour below 2x minContourArea: false-positive candidates
+    long analyzedFrames = 0;
+    int64_t ticks = 0;         // time spent in motion analysis
+};
+
+static std::vector<std::string> split(const std::string& text, char delimiter) {
+    std::vector<std::string> parts;
+    std::istringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, delimiter)) {
+        if (!part.empty()) parts.push_back(part);
+    }
+    return parts;
+}
+
+static std::string configLabel(const SweepConfig& c) {
+    std::ostringstream label;
+    label << "t" << c.motionThreshold << "_a" << c.minContourArea
+          << "_s" << c.frameSkip << "_C" << c.cooldownSeconds;
+    return label.str();
+}
+
+bool parseSweepGrid(const std::string& grid, const SweepConfig& base, std::vector<SweepConfig>& configs) {
+    configs.assign(1, base);
+
+    for (const std::string& entry : split(grid, ';')) {
+        size_t eq = entry.find('=');
+        if (eq != 1) {
+            std::cerr << "Invalid sweep grid entry: " << entry << "\n";
+            return false;
+        }
+        char key = entry[0];
+        std::vector<std::string> values = split(entry.substr(2), ',');
+        if (values.empty()) {
+            std::cerr << "No values for sweep parameter: " << key << "\n";
+            return false;
+        }
+
+        std::vector<SweepConfig> expanded;
+        try {
+            for (const SweepConfig& c : configs) {
+                for (const std::string& value : values) {
+                    SweepConfig next = c;
+                    switch (key) {
+                        case 't': next.motionThreshold = std::stoi(value); break;
+                        case 'a': next.minContourArea = std::stoi(value); break;
+                        case 's': next.frameSkip = std::max(1, std::stoi(value)); break;
+                        case 'C': next.cooldownSeconds = std::stod(value); break;
+                        default:
+                            std::cerr << "Unknown sweep parameter: " << key << " (use t, a, s, C)\n";
+                            return false;
+                    }
+                    expanded.push_back(next);
+                }
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Invalid value for sweep parameter " << key << ": " << e.what() << "\n";
+            return false;
+        }
+        configs.swap(expanded);
+    }
+    return true;
+}
+
+bool runParameterSweep(const std::string& videoPath, const cv::Rect& detectionArea,
+                       const std::vector<SweepConfig>& configs, const std::string& outputDir,
+                       bool lumaDecode) {
+    FrameSource source(videoPath, lumaDecode);
+    if (!source.isOpened()) {
+        std::cerr << "Error opening video file: " << videoPath << "\n";
+        return false;
+    }
+
+    // Only the detection area is kept, it is all the analysis looks at
+    cv::Mat gray;
+    if (!source.grab() || !source.retrieveGray(gray)) {
+        std::cerr << "Error reading first frame\n";
+        return false;
+    }
+    cv::Mat firstGray = gray(detectionArea).clone();
+    const double contrast = source.grayContrast();
+
+    std::vector<SweepState> states(configs.size());
+    for (size_t i = 0; i < configs.size(); ++i) {
+        states[i].config = configs[i];
+        states[i].grayPrev = firstGray;
+        states[i].lastDetectionTime = -configs[i].cooldownSeconds;
+    }
+
+    std::cout << "Sweeping " << configs.size() << " configurations over " << videoPath << std::endl;
+
+    const int64_t start = cv::getTickCount();
+    long frameCount = 0;
+    long decodedFrames = 0;
+    std::vector<SweepState*> active;
+    active.reserve(states.size());
+
+    while (source.grab()) {
+        frameCount++;
+
+        active.clear();
+        for (SweepState& state : states) {
+            if (frameCount % state.config.frameSkip == 0) active.push_back(&state);
+        }
+        // Frames no configuration looks at are never converted
+        if (active.empty()) continue;
+
+        if (!source.retrieveGray(gray)) break;
+        decodedFrames++;
+        const double timestamp = source.positionSeconds();
+
+        // retrieveGray() may point into the decoder, configurations keep their own ROI copy
+        cv::Mat grayCurrent = gray(detectionArea).clone();
+
+        cv::parallel_for_(cv::Range(0, static_cast<int>(active.size())), [&](const cv::Range& range) {
+            for (int i = range.start; i < range.end; ++i) {
+                SweepState& state = *active[i];
+                const int64_t begin = cv::getTickCount();
+                state.analyzedFrames++;
+
+                if (timestamp - state.lastDetectionTime >= state.config.cooldownSeconds) {
+                    double largest = 0;
+                    const int threshold = cvRound(state.config.motionThreshold * contrast);
+                    for (const auto& contour : findMotionContours(state.grayPrev, grayCurrent, threshold)) {
+                        largest = std::max(largest, cv::contourArea(contour));
+                    }
+                    if (largest > state.config.minContourArea) {
+                        state.lastDetectionTime = timestamp;
+                        state.events.push_back(timestamp);
+                        if (largest < 2.0 * state.config.minContourArea) state.weakEvents++;
+                    }
+                }
+
+                state.grayPrev = grayCurrent;
+                state.ticks += cv::getTickCount() - begin;
+            }
+        });
+    }
+
+    const double elapsed = (cv::getTickCount() - start) / cv::getTickFrequency();
+
+    fs::create_directories(outputDir);
+    for (const SweepState& state : states) {
+        std::ofstream log((fs::path(outputDir) / (configLabel(state.config) + ".txt")).string());
+        for (double t : state.events) log << "Motion detected at: " << formatTimestamp(t) << "\n";
+    }
+
+    std::ostringstream table;
+    table << std::left << std::setw(28) << "config"
+          << std::right << std::setw(8) << "events"
+          << std::setw(8) << "weak"
+          << std::setw(10) << "frames"
+          << std::setw(12) << "cost, ms"
+          << std::setw(12) << "ms/frame" << "\n";
+    for (const SweepState& state : states) {
+        double costMs = state.ticks * 1000.0 / cv::getTickFrequency();
+        table << std::left << std::setw(28) << configLabel(state.config)
+              << std::right << std::setw(8) << state.events.size()
+              << std::setw(8) << state.weakEvents
+              << std::setw(10) << state.analyzedFrames
+              << std::setw(12) << std::fixed << std::setprecision(1) << costMs
+              << std::setw(12) << std::setprecision(3)
+              << (state.analyzedFrames ? costMs / state.analyzedFrames : 0.0) << "\n";
+    }
+    table << "\nFrames: " << frameCount + 1 << " total, " << decodedFrames + 1 << " retrieved once for all configurations, "
+          << std::setprecision(1) << elapsed << " s wall time\n";
+
+    std::ofstream summary((fs::path(outputDir) / "summary.txt").string());
+    summary << table.str();
+    std::cout << "\n" << table.str();
+    std::cout << "Event logs and summary saved in: " << outputDir << std::endl;
+    return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+struct SweepConfig {
+    int frameSkip = 20;
+    int motionThreshold = 25;
+    int minContourArea = 500;
+    double cooldownSeconds = 20.0;
+};
+
+// Expands a grid like "t=15,25,35;a=300,500;s=10,20;C=10,20" into all combinations.
+// Parameters missing from the grid keep the value from base.
+bool parseSweepGrid(const std::string& grid, const SweepConfig& base, std::vector<SweepConfig>& configs);
+
+// Decodes the video once and evaluates every configuration on the shared gray ROI.
+// Writes one event log per configuration plus summary.txt into outputDir.
+bool runParameterSweep(const std::string& videoPath, const cv::Rect& detectionArea,
+                       const std::vector<SweepConfig>& configs, const std::string& outputDir,
+                       bool lumaDecode = true);